@@ -0,0 +1,200 @@
+#include "imagecache.h"
+
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QtGui>
+
+// Share of the budget reserved for entries that have been requested more than once
+static const int PROTECTED_PERCENT = 80;
+
+ImageCache::ImageCache(qint64 maxBytes)
+    : probationBytes(0)
+    , protectedBytes(0)
+    , budget(maxBytes)
+{
+}
+
+/**
+ * This function returns the decoded image for the given path and level. The image is decoded and inserted
+ * into the cache on a miss. The returned QImage shares its pixel data with the cached entry, so holding on to
+ * it is cheap but keeps the entry from being evicted until it is released.
+ *
+ * @param path The path of the image file.
+ * @param level The size of the box the image is scaled to fit in.
+ * @return The decoded image, or a null QImage if the file could not be read.
+ */
+QImage ImageCache::image(const QString &path, int level)
+{
+    Key key { path, level };
+
+    {
+        QMutexLocker locker(&mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            touch(it.value());
+            return it->image;
+        }
+    }
+
+    // Decode outside of the lock so other features are not blocked on disk reads
+    QImage decoded = decode(key);
+    if (decoded.isNull()) {
+        return decoded;
+    }
+
+    QMutexLocker locker(&mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        // Another caller decoded the same image in the meantime
+        touch(it.value());
+        return it->image;
+    }
+
+    probation.push_front(key);
+    Entry entry { decoded, decoded.sizeInBytes(), false, probation.begin() };
+    probationBytes += entry.bytes;
+    entries.insert(key, entry);
+    evict();
+    return decoded;
+}
+
+/**
+ * This function drops every cached level of the given path.
+ *
+ * @param path The path of the image file.
+ */
+void ImageCache::remove(const QString &path)
+{
+    QMutexLocker locker(&mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it.key().path != path) {
+            ++it;
+            continue;
+        }
+        if (it->isProtected) {
+            protectedBytes -= it->bytes;
+            protectedSegment.erase(it->position);
+        } else {
+            probationBytes -= it->bytes;
+            probation.erase(it->position);
+        }
+        it = entries.erase(it);
+    }
+}
+
+void ImageCache::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&mutex);
+    budget = maxBytes;
+    evict();
+}
+
+/**
+ * This function decodes the image described by the key. The reader is asked for a scaled decode so plugins
+ * that support it never materialize the full resolution image, and the result is converted to the pixmap
+ * format up front so the pixels are never held a second time in another format.
+ *
+ * @param key The path and level to decode.
+ * @return The decoded image, or a null QImage if the file could not be read.
+ */
+QImage ImageCache::decode(const Key &key)
+{
+    QImageReader reader(key.path);
+    QSize size = reader.size();
+    if (size.isValid() && (size.width() > key.level || size.height() > key.level)) {
+        reader.setScaledSize(size.scaled(key.level, key.level, Qt::KeepAspectRatio));
+    }
+
+    QImage decoded = reader.read();
+    if (decoded.isNull()) {
+        qDebug() << "Failed to load image:" << key.path << reader.errorString();
+        return decoded;
+    }
+
+    // Readers without size support fall back to a full decode, so scale it down here
+    if (decoded.width() > key.level || decoded.height() > key.level) {
+        decoded = decoded.scaled(key.level, key.level, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // Match the raster pixmap format, e.g. for 16 bit TIFFs, so QPixmap::fromImage shares instead of copying
+    QImage::Format pixmapFormat = decoded.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    if (decoded.format() != pixmapFormat) {
+        decoded = decoded.convertToFormat(pixmapFormat);
+    }
+    return decoded;
+}
+
+/**
+ * This function records a hit on an entry. Probationary entries are promoted to the protected segment, and
+ * the least recently used protected entries are demoted back to probation once the segment is over its share.
+ *
+ * @param entry The entry that was requested.
+ */
+void ImageCache::touch(Entry &entry)
+{
+    if (entry.isProtected) {
+        protectedSegment.splice(protectedSegment.begin(), protectedSegment, entry.position);
+        return;
+    }
+
+    protectedSegment.splice(protectedSegment.begin(), probation, entry.position);
+    entry.isProtected = true;
+    probationBytes -= entry.bytes;
+    protectedBytes += entry.bytes;
+
+    qint64 protectedLimit = budget / 100 * PROTECTED_PERCENT;
+    while (protectedBytes > protectedLimit && protectedSegment.size() > 1) {
+        auto last = std::prev(protectedSegment.end());
+        Entry &demoted = entries[*last];
+        probation.splice(probation.begin(), protectedSegment, last);
+        demoted.isProtected = false;
+        protectedBytes -= demoted.bytes;
+        probationBytes += demoted.bytes;
+    }
+}
+
+/**
+ * This function evicts entries until the cache is within its budget, draining the probationary segment
+ * before touching the protected one.
+ */
+void ImageCache::evict()
+{
+    if (!evictFrom(probation, probationBytes, budget - protectedBytes)) {
+        evictFrom(protectedSegment, protectedBytes, budget - probationBytes);
+    }
+}
+
+/**
+ * This function evicts the least recently used entries of a segment until the segment fits in the limit.
+ * Entries whose image is still held outside of the cache are skipped, since dropping them would not free
+ * any memory.
+ *
+ * @param segment The segment to evict from.
+ * @param segmentBytes [in,out] The number of bytes held by the segment.
+ * @param limit The number of bytes the segment may hold.
+ * @return True if the segment fits in the limit.
+ */
+bool ImageCache::evictFrom(KeyList &segment, qint64 &segmentBytes, qint64 limit)
+{
+    auto it = segment.end();
+    while (segmentBytes > limit && it != segment.begin()) {
+        --it;
+        auto entry = entries.find(*it);
+        if (!entry->image.isDetached()) {
+            continue;
+        }
+        segmentBytes -= entry->bytes;
+        entries.erase(entry);
+        it = segment.erase(it);
+    }
+    return segmentBytes <= limit;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+size_t qHash(const ImageCache::Key &key, size_t seed)
+#else
+uint qHash(const ImageCache::Key &key, uint seed)
+#endif
+{
+    return qHash(key.path, seed) ^ qHash(key.level, seed);
+}
@@ -0,0 +1,79 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <iterator>
+#include <list>
+
+/**
+ * A memory-budgeted cache of decoded thumbnails shared by the thumbnail grid, the image viewer and the
+ * save functions.
+ *
+ * Entries are keyed by (path, level), where the image is decoded scaled to fit inside a level x level box and
+ * converted to the format QPixmap uses on screen. The cache is the only owner of the decoded pixels: entries
+ * are handed out as QImage copies that share pixel data with the cache through QImage's reference count, and
+ * QPixmap::fromImage shares them again instead of converting. Callers should only hold on to an image while
+ * it is on screen, since an entry that is still shared cannot be evicted.
+ *
+ * Eviction uses a segmented LRU: new entries start in a probationary segment and are only promoted to the
+ * protected segment when they are requested again. Thumbnails the user has viewed or saved are therefore
+ * kept while a large import cycles through the probationary segment. One-off scans such as stitching should
+ * decode directly instead of going through the cache, since their images are never requested again.
+ */
+class ImageCache
+{
+public:
+    static constexpr qint64 DefaultMaxBytes = 512ll * 1024 * 1024;
+
+    explicit ImageCache(qint64 maxBytes = DefaultMaxBytes);
+
+    QImage image(const QString &path, int level);
+    void remove(const QString &path);
+    void setMaxBytes(qint64 maxBytes);
+
+    struct Key
+    {
+        QString path;
+        int level;
+
+        bool operator==(const Key &other) const
+        {
+            return level == other.level && path == other.path;
+        }
+    };
+
+private:
+    using KeyList = std::list<Key>;
+
+    struct Entry
+    {
+        QImage image;
+        qint64 bytes;
+        bool isProtected;
+        KeyList::iterator position;
+    };
+
+    static QImage decode(const Key &key);
+    void touch(Entry &entry);
+    void evict();
+    bool evictFrom(KeyList &segment, qint64 &segmentBytes, qint64 limit);
+
+    QMutex mutex;
+    QHash<Key, Entry> entries;
+    KeyList probation;
+    KeyList protectedSegment;
+    qint64 probationBytes;
+    qint64 protectedBytes;
+    qint64 budget;
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+size_t qHash(const ImageCache::Key &key, size_t seed = 0);
+#else
+uint qHash(const ImageCache::Key &key, uint seed = 0);
+#endif
+
+#endif // IMAGECACHE_H
@@ -0,0 +1,295 @@
+#include "imageencoder.h"
+
+#include <QFile>
+#include <QImageWriter>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <QtGui>
+#include <cstring>
+
+#ifdef BIOLABEL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Smallest band worth handing to another thread
+static const int MIN_BAND_ROWS = 64;
+
+/**
+ * This function returns the file suffix for an output format.
+ *
+ * @param format The output format.
+ * @return The suffix without the leading dot.
+ */
+QString ImageEncoder::suffix(OutputFormat format)
+{
+    switch (format) {
+    case UncompressedTiff:
+    case LzwTiff:
+        return "tif";
+    case RawPpm:
+        return "ppm";
+    case FastPng:
+    case CompactPng:
+    default:
+        return "png";
+    }
+}
+
+/**
+ * This function writes an image to disk in the given output format.
+ *
+ * @param image The image to save.
+ * @param filePath The path to save the image to, including the suffix of the format.
+ * @param format The output format.
+ * @return True if the image was written.
+ */
+bool ImageEncoder::save(const QImage &image, const QString &filePath, OutputFormat format)
+{
+    switch (format) {
+    case CompactPng:
+        return savePng(image, filePath, 6);
+    case UncompressedTiff:
+        return saveTiff(image, filePath, 0);
+    case LzwTiff:
+        return saveTiff(image, filePath, 1);
+    case RawPpm:
+        return savePpm(image, filePath);
+    case FastPng:
+    default:
+        return savePng(image, filePath, 1);
+    }
+}
+
+#ifdef BIOLABEL_HAVE_ZLIB
+
+/**
+ * A band of rows that is filtered and deflated independently of the others.
+ */
+struct PngBand
+{
+    int firstRow;
+    int rowCount;
+    bool last;
+    QByteArray chunk;
+    uLong adler;
+    uLong length;
+    bool ok;
+};
+
+/**
+ * This function wraps data into a PNG chunk with its length and CRC.
+ *
+ * @param type The four character chunk type.
+ * @param data The chunk payload.
+ * @return The encoded chunk.
+ */
+static QByteArray pngChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk(12 + data.size(), Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(chunk.data());
+    qToBigEndian<quint32>(data.size(), out);
+    memcpy(out + 4, type, 4);
+    memcpy(out + 8, data.constData(), data.size());
+    uLong crc = crc32(0, out + 4, 4 + data.size());
+    qToBigEndian<quint32>(crc, out + 8 + data.size());
+    return chunk;
+}
+
+/**
+ * This function writes an image as a PNG, deflating row bands in parallel. Every band starts a fresh raw
+ * deflate stream and all but the last end on a sync flush, so the bands concatenate into one valid zlib
+ * stream whose Adler-32 checksum is combined from the per band checksums. Rows use the Up filter, which only
+ * needs the unfiltered previous row and therefore crosses band boundaries freely.
+ *
+ * @param image The image to save.
+ * @param filePath The path to save the image to.
+ * @param level The zlib compression level.
+ * @return True if the image was written.
+ */
+bool ImageEncoder::savePng(const QImage &image, const QString &filePath, int level)
+{
+    if (image.isNull()) {
+        return false;
+    }
+
+    // Pick the PNG color type matching the pixels
+    QImage pixels;
+    quint8 colorType;
+    int bytesPerPixel;
+    if (image.format() == QImage::Format_Grayscale8) {
+        pixels = image;
+        colorType = 0;
+        bytesPerPixel = 1;
+    } else if (image.hasAlphaChannel()) {
+        pixels = image.convertToFormat(QImage::Format_RGBA8888);
+        colorType = 6;
+        bytesPerPixel = 4;
+    } else {
+        pixels = image.convertToFormat(QImage::Format_RGB888);
+        colorType = 2;
+        bytesPerPixel = 3;
+    }
+    const int width = pixels.width();
+    const int height = pixels.height();
+    const int rowBytes = width * bytesPerPixel;
+
+    // Split the rows into bands, a few per core so uneven bands still balance
+    int bandCount = qBound(1, height / MIN_BAND_ROWS, QThread::idealThreadCount() * 4);
+    int rowsPerBand = (height + bandCount - 1) / bandCount;
+    QVector<PngBand> bands;
+    for (int row = 0; row < height; row += rowsPerBand) {
+        bands.append({ row, qMin(rowsPerBand, height - row), false, QByteArray(), 0, 0, false });
+    }
+    bands.last().last = true;
+
+    QtConcurrent::blockingMap(bands, [&pixels, rowBytes, level](PngBand &band) {
+        // Filter the rows of the band
+        QByteArray filtered(band.rowCount * (rowBytes + 1), Qt::Uninitialized);
+        uchar *out = reinterpret_cast<uchar *>(filtered.data());
+        for (int y = band.firstRow; y < band.firstRow + band.rowCount; y++) {
+            const uchar *current = pixels.constScanLine(y);
+            *out++ = 2;
+            if (y == 0) {
+                memcpy(out, current, rowBytes);
+            } else {
+                const uchar *previous = pixels.constScanLine(y - 1);
+                for (int i = 0; i < rowBytes; i++) {
+                    out[i] = uchar(current[i] - previous[i]);
+                }
+            }
+            out += rowBytes;
+        }
+        band.length = filtered.size();
+        band.adler = adler32(adler32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(filtered.constData()), band.length);
+
+        // Deflate the band into a raw stream
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return;
+        }
+        QByteArray compressed(int(deflateBound(&stream, band.length)) + 16, Qt::Uninitialized);
+        stream.next_in = reinterpret_cast<Bytef *>(filtered.data());
+        stream.avail_in = band.length;
+        stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+        stream.avail_out = compressed.size();
+        int result = deflate(&stream, band.last ? Z_FINISH : Z_SYNC_FLUSH);
+        band.ok = band.last ? result == Z_STREAM_END : (result == Z_OK && stream.avail_out > 0);
+        compressed.truncate(int(stream.total_out));
+        deflateEnd(&stream);
+
+        band.chunk = pngChunk("IDAT", compressed);
+    });
+
+    // Stitch the checksums of the bands together
+    uLong adler = adler32(0, Z_NULL, 0);
+    for (const PngBand &band : bands) {
+        if (!band.ok) {
+            qDebug() << "Failed to compress image:" << filePath;
+            return false;
+        }
+        adler = adler32_combine(adler, band.adler, band.length);
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray header(13, Qt::Uninitialized);
+    uchar *ihdr = reinterpret_cast<uchar *>(header.data());
+    qToBigEndian<quint32>(width, ihdr);
+    qToBigEndian<quint32>(height, ihdr + 4);
+    ihdr[8] = 8;
+    ihdr[9] = colorType;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+
+    // The zlib header and trailer go in IDAT chunks of their own around the bands
+    QByteArray zlibHeader(2, Qt::Uninitialized);
+    zlibHeader[0] = char(0x78);
+    zlibHeader[1] = char(level < 2 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda);
+    QByteArray zlibTrailer(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(adler, zlibTrailer.data());
+
+    file.write("\x89PNG\r\n\x1a\n", 8);
+    file.write(pngChunk("IHDR", header));
+    file.write(pngChunk("IDAT", zlibHeader));
+    for (const PngBand &band : bands) {
+        file.write(band.chunk);
+    }
+    file.write(pngChunk("IDAT", zlibTrailer));
+    file.write(pngChunk("IEND", QByteArray()));
+
+    // Close before checking for errors so failures writing out the buffered data, e.g. a full disk, are reported
+    file.close();
+    return file.error() == QFileDevice::NoError;
+}
+
+#else
+
+/**
+ * This function writes an image as a PNG through the Qt PNG plugin when the build has no zlib to deflate in
+ * parallel with. The plugin derives its zlib level from the quality, so the level is mapped back onto it.
+ *
+ * @param image The image to save.
+ * @param filePath The path to save the image to.
+ * @param level The zlib compression level.
+ * @return True if the image was written.
+ */
+bool ImageEncoder::savePng(const QImage &image, const QString &filePath, int level)
+{
+    QImageWriter writer(filePath, "png");
+    writer.setQuality(100 - (level * 91 + 8) / 9);
+    if (!writer.write(image)) {
+        qDebug() << "Failed to save image:" << filePath << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+/**
+ * This function writes an image as a TIFF through the Qt TIFF plugin, which encodes on a single thread.
+ *
+ * @param image The image to save.
+ * @param filePath The path to save the image to.
+ * @param compression 0 for uncompressed, 1 for LZW.
+ * @return True if the image was written.
+ */
+bool ImageEncoder::saveTiff(const QImage &image, const QString &filePath, int compression)
+{
+    QImageWriter writer(filePath, "tiff");
+    writer.setCompression(compression);
+    if (!writer.write(image)) {
+        qDebug() << "Failed to save image:" << filePath << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * This function writes an image as a binary PPM, i.e. the raw RGB rows behind a short text header.
+ *
+ * @param image The image to save.
+ * @param filePath The path to save the image to.
+ * @return True if the image was written.
+ */
+bool ImageEncoder::savePpm(const QImage &image, const QString &filePath)
+{
+    QImage pixels = image.convertToFormat(QImage::Format_RGB888);
+    QFile file(filePath);
+    if (pixels.isNull() || !file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    file.write(QString("P6\n%1 %2\n255\n").arg(pixels.width()).arg(pixels.height()).toLatin1());
+    for (int y = 0; y < pixels.height(); y++) {
+        file.write(reinterpret_cast<const char *>(pixels.constScanLine(y)), pixels.width() * 3);
+    }
+    file.close();
+    return file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include <QImage>
+#include <QString>
+
+/**
+ * Writes stitched mosaics to disk in the output format selected by the user.
+ *
+ * PNG output is deflated in parallel: the image is split into row bands that are filtered and compressed
+ * independently on the global thread pool and then concatenated into a single zlib stream, so encode time
+ * scales with the number of cores instead of being a single threaded tail. TIFF output is still encoded on one
+ * thread by the Qt TIFF plugin, and raw output is written as a binary PPM without any encoding.
+ */
+class ImageEncoder
+{
+public:
+    // Order matches the items of the output format combo box
+    enum OutputFormat {
+        FastPng,
+        CompactPng,
+        UncompressedTiff,
+        LzwTiff,
+        RawPpm
+    };
+
+    static QString suffix(OutputFormat format);
+    static bool save(const QImage &image, const QString &filePath, OutputFormat format);
+
+private:
+    static bool savePng(const QImage &image, const QString &filePath, int level);
+    static bool saveTiff(const QImage &image, const QString &filePath, int compression);
+    static bool savePpm(const QImage &image, const QString &filePath);
+};
+
+#endif // IMAGEENCODER_H
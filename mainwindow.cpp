@@ -9,6 +9,20 @@
 #include <iostream>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QScrollBar>
+
+// Size the grid thumbnails are decoded at, and how much the larger image view enlarges them
+static const int THUMBNAIL_SIZE = 220;
+static const int VIEWER_SCALE = 4;
+
+// Layout of the thumbnail grid, buttons are created BATCH_ROWS rows at a time and PREFETCH_ROWS ahead of view
+static const int GRID_COLUMNS = 5;
+static const int BATCH_ROWS = 4;
+static const int PREFETCH_ROWS = 2;
+
+// Number of pixels neighbouring tiles overlap by
+static const int TILE_OVERLAP_X = 289;
+static const int TILE_OVERLAP_Y = 216;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -31,12 +45,21 @@ MainWindow::MainWindow(QWidget *parent)
     scrollArea->setWidgetResizable(true);
     scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 
+    // Allow the decoded image budget to be tuned for the machine, e.g. BIOLABEL_CACHE_MB=256 on small laptops
+    bool ok = false;
+    int cacheMegabytes = qEnvironmentVariableIntValue("BIOLABEL_CACHE_MB", &ok);
+    if (ok && cacheMegabytes > 0) {
+        imageCache.setMaxBytes(qint64(cacheMegabytes) * 1024 * 1024);
+    }
+
     connect(uploadButton, &QToolButton::clicked, this, &MainWindow::uploadFolder);
     connect(saveGoodButton, &QPushButton::clicked, this, &MainWindow::saveGoodImages);
     connect(saveBadButton, &QPushButton::clicked, this, &MainWindow::saveBadImages);
     connect(ui->goodCheckBox, &QCheckBox::stateChanged, this, &MainWindow::viewGoodImages);
     connect(ui->badCheckBox, &QCheckBox::stateChanged, this, &MainWindow::viewBadImages);
     connect(stitchButton, &QToolButton::clicked, this, &MainWindow::uploadRawFolder);
+    connect(scrollArea->verticalScrollBar(), &QScrollBar::valueChanged, this, &MainWindow::loadVisibleThumbnails);
+    connect(scrollArea->verticalScrollBar(), &QScrollBar::rangeChanged, this, &MainWindow::loadVisibleThumbnails);
 }
 
 MainWindow::~MainWindow()
@@ -82,7 +105,8 @@ void getAllImageFiles(const QString &folderPath, QFileInfoList &imageFiles) {
  * The stitched images are then displayed as thumbnail buttons in a grid layout in the main window.
  * The user can interact with the buttons to view larger images, mark them as good or bad, and delete them.
  * The function assumes that each subfolder with images that need to be stitched begins with the naming convention "XY".
- * The stitched images are saved to another user-selected folder.
+ * The images are queued behind any images already in the grid, and buttons are only created for the rows
+ * that are scrolled into view.
  *
  * @author Kai Jun Zhuang
  */
@@ -105,130 +129,252 @@ void MainWindow::uploadFolder()
     QFileInfoList imageFiles;
     getAllImageFiles(folderPath, imageFiles);
 
-    // Initialize variables for traversing the gridLayout
-    int row = 0;
-    int col = 0;
-    const int COLUMNS = 5; // Number of columns in the grid
+    // Queue the images and create buttons for the ones in view
+    for (const QFileInfo &fileInfo : imageFiles) {
+        pendingImages.append(fileInfo.absoluteFilePath());
+    }
+    loadVisibleThumbnails();
+}
 
-    // Get the current number of rows and columns in the grid layout
-    int currentRows = layout->rowCount() - 1;
-    int currentCols = layout->columnCount() - 1;
+/**
+ * This function creates thumbnail buttons for queued images until there are enough to fill the rows of the
+ * scroll area's viewport, plus a few rows ahead. The number of buttons needed is derived from the scroll
+ * position and the row height rather than from the grid's size, and only buttons shown by the good and bad
+ * images filters count towards it, since hidden buttons take up no space. New buttons are bad, so nothing is
+ * loaded while bad images are hidden. Buttons are added in batches of whole rows with the layout and repaints
+ * suspended, so the grid is only laid out once per call instead of once per button.
+ */
+void MainWindow::loadVisibleThumbnails()
+{
+    if (pendingImages.isEmpty() || !ui->badCheckBox->isChecked()) {
+        updateThumbnailIcons();
+        return;
+    }
 
-    // Set the row and column indices to the next available position in the grid
-    row = currentRows;
-    col = currentCols;
-    if (col + 1 == COLUMNS) {
-        col = 0;
-        row++;
+    // Work out how many buttons cover the viewport, rounded up to whole batches
+    QScrollArea *scrollArea = ui->scrollArea;
+    int buttonHeight = thumbnailButtons.isEmpty() ? THUMBNAIL_SIZE : thumbnailButtons.first()->sizeHint().height();
+    int rowHeight = buttonHeight + qMax(0, layout->verticalSpacing());
+    int visibleBottom = scrollArea->verticalScrollBar()->value() + scrollArea->viewport()->height();
+    int visibleRows = visibleBottom / rowHeight + 1 + PREFETCH_ROWS;
+    int batchSize = GRID_COLUMNS * BATCH_ROWS;
+    int target = (visibleRows * GRID_COLUMNS + batchSize - 1) / batchSize * batchSize;
+    int shownCount = 0;
+    for (QPushButton *button : thumbnailButtons) {
+        if (!button->isHidden()) {
+            shownCount++;
+        }
+    }
+    if (shownCount >= target) {
+        updateThumbnailIcons();
+        return;
     }
 
-    for (const QFileInfo &fileInfo : imageFiles) {
-        // Load the image file into a QPixmap
-        QPixmap pixmap;
-        if (!pixmap.load(fileInfo.absoluteFilePath())) {
-            qDebug() << "Failed to load image:" << fileInfo.absoluteFilePath();
+    QWidget *gridWidget = scrollArea->widget();
+    gridWidget->setUpdatesEnabled(false);
+    layout->setEnabled(false);
+
+    while (!pendingImages.isEmpty() && shownCount < target) {
+        QPushButton *button = createThumbnailButton(pendingImages.takeFirst());
+        if (!button) {
             continue;
         }
 
-        // Scale the pixmap to a larger thumbnail size
-        pixmap = pixmap.scaled(220, 220, Qt::KeepAspectRatio);
-
-        // Create a QPushButton widget to display the pixmap
-        QPushButton *button = new QPushButton();
-        button->setIcon(pixmap);
-        button->setIconSize(pixmap.size());
-        button->setFlat(true);
-        button->setAutoFillBackground(true);
-        button->setProperty("imagePath", fileInfo.absoluteFilePath());
-        button->setCursor(Qt::PointingHandCursor);
-
-        // Set the button's palette to red
-        QPalette palette;
-        palette.setColor(QPalette::Button, Qt::red);
-        button->setPalette(palette);
-
-        // Add the button to the grid layout
-        layout->addWidget(button, row, col);
-
-        // Connect the button's clicked signal to a slot
-        connect(button, &QPushButton::clicked, [this, button]() {
-            // Toggle the border on and off when the button is clicked
-            if (button->palette().color(QPalette::Button) == Qt::green) {
-                QPalette palette;
-                palette.setColor(QPalette::Button, Qt::red);
-                button->setPalette(palette);
-            } else {
-                QPalette palette;
-                palette.setColor(QPalette::Button, Qt::green);
-                button->setPalette(palette);
-            }
-        });
+        // Add the button to the next free cell of the grid layout
+        int index = thumbnailButtons.size();
+        thumbnailButtons.append(button);
+        layout->addWidget(button, index / GRID_COLUMNS, index % GRID_COLUMNS);
 
-        // Create a context menu for the button
-        QMenu *contextMenu = new QMenu(this);
+        // Show the button right away rather than on the next event loop pass, so it counts as shown
+        button->setVisible(true);
+        shownCount++;
+    }
 
-        // Actions for the context menu
-        QAction *openInNewWindow = new QAction("View larger image", this);
-        QAction *deleteButton = new QAction("Delete", this);
-        contextMenu->addAction(openInNewWindow);
-        contextMenu->addAction(deleteButton);
+    layout->setEnabled(true);
+    layout->activate();
+    gridWidget->setUpdatesEnabled(true);
+    updateThumbnailIcons();
+}
 
-        // Context Menu Settings
-        button->setContextMenuPolicy(Qt::CustomContextMenu);
+/**
+ * This function gives the thumbnail buttons within PREFETCH_ROWS rows of the viewport their icon and takes
+ * it away from the others. The image cache is the only owner of the decoded thumbnails, and an icon shares
+ * its pixels with the cached entry, so only the buttons near the viewport pin entries in the cache. The rest
+ * can be evicted to stay within the budget and are decoded again when they are scrolled back into view.
+ */
+void MainWindow::updateThumbnailIcons()
+{
+    QScrollArea *scrollArea = ui->scrollArea;
+    int margin = PREFETCH_ROWS * (THUMBNAIL_SIZE + qMax(0, layout->verticalSpacing()));
+    int visibleTop = scrollArea->verticalScrollBar()->value() - margin;
+    int visibleBottom = scrollArea->verticalScrollBar()->value() + scrollArea->viewport()->height() + margin;
+
+    // Make sure buttons that were just shown have their place in the grid
+    layout->activate();
+    for (QPushButton *button : thumbnailButtons) {
+        QRect geometry = button->geometry();
+        bool nearView = !button->isHidden() && geometry.bottom() >= visibleTop && geometry.top() <= visibleBottom;
+        if (nearView && button->icon().isNull()) {
+            QImage thumbnail = imageCache.image(button->property("imagePath").toString(), THUMBNAIL_SIZE);
+            button->setIcon(QPixmap::fromImage(thumbnail));
+        } else if (!nearView && !button->icon().isNull()) {
+            button->setIcon(QIcon());
+        }
+    }
+}
 
-        connect(button, &QPushButton::customContextMenuRequested, [this, button, contextMenu, pixmap](){
-            contextMenu->exec(QCursor::pos());
-        });
+/**
+ * This function creates the thumbnail button for an image, along with its context menu for viewing
+ * the larger image, marking it as good or bad, and deleting it.
+ *
+ * @param imagePath The path to the image.
+ * @return The new button, or nullptr if the image could not be loaded.
+ */
+QPushButton *MainWindow::createThumbnailButton(const QString &imagePath)
+{
+    // Load the thumbnail through the shared image cache
+    QImage thumbnail = imageCache.image(imagePath, THUMBNAIL_SIZE);
+    if (thumbnail.isNull()) {
+        return nullptr;
+    }
 
-        // Open In New Window functionality
-        connect(openInNewWindow, &QAction::triggered, [this, button, pixmap](){
-            // Create a new window to display the image
-            QDialog *imageDialog = new QDialog(this);
-            imageDialog->setWindowTitle("Image View");
-            QLabel *label = new QLabel(imageDialog);
-            label->setPixmap(pixmap.scaled(pixmap.width()*4, pixmap.height()*4, Qt::KeepAspectRatio));
-            QVBoxLayout *layout = new QVBoxLayout(imageDialog);
-            layout->addWidget(label);
-            QHBoxLayout *buttonLayout = new QHBoxLayout();
-            QPushButton *setGreen = new QPushButton("Mark as Good", imageDialog);
-            QPushButton *setRed = new QPushButton("Mark as Bad", imageDialog);
-            buttonLayout->addWidget(setGreen);
-            buttonLayout->addWidget(setRed);
-            layout->addLayout(buttonLayout);
-
-            if(button->palette().color(QPalette::Button) == Qt::green)
-                setGreen->setDisabled(true);
-            else if(button->palette().color(QPalette::Button) == Qt::red)
-                setRed->setDisabled(true);
-
-            connect(setGreen, &QPushButton::clicked, [this, button, imageDialog](){
-                QPalette palette;
-                palette.setColor(QPalette::Button, Qt::green);
-                button->setPalette(palette);
-                imageDialog->accept();
-            });
-            connect(setRed, &QPushButton::clicked, [this, button, imageDialog](){
-                QPalette palette;
-                palette.setColor(QPalette::Button, Qt::red);
-                button->setPalette(palette);
-                imageDialog->accept();
-            });
-            imageDialog->exec();
+    // Create a QPushButton widget to display the pixmap, fixed to its size so it keeps its cell without an icon
+    QPushButton *button = new QPushButton();
+    button->setIcon(QPixmap::fromImage(thumbnail));
+    button->setIconSize(thumbnail.size());
+    button->setFixedSize(button->sizeHint());
+    button->setFlat(true);
+    button->setAutoFillBackground(true);
+    button->setProperty("imagePath", imagePath);
+    button->setCursor(Qt::PointingHandCursor);
+
+    // Set the button's palette to red
+    QPalette palette;
+    palette.setColor(QPalette::Button, Qt::red);
+    button->setPalette(palette);
+
+    // Connect the button's clicked signal to a slot
+    connect(button, &QPushButton::clicked, [this, button]() {
+        // Toggle the border on and off when the button is clicked
+        if (button->palette().color(QPalette::Button) == Qt::green) {
+            QPalette palette;
+            palette.setColor(QPalette::Button, Qt::red);
+            button->setPalette(palette);
+        } else {
+            QPalette palette;
+            palette.setColor(QPalette::Button, Qt::green);
+            button->setPalette(palette);
+        }
+    });
+
+    // Create a context menu for the button, owned by the button so it is cleaned up on delete
+    QMenu *contextMenu = new QMenu(button);
+
+    // Actions for the context menu
+    QAction *openInNewWindow = new QAction("View larger image", contextMenu);
+    QAction *deleteButton = new QAction("Delete", contextMenu);
+    contextMenu->addAction(openInNewWindow);
+    contextMenu->addAction(deleteButton);
+
+    // Context Menu Settings
+    button->setContextMenuPolicy(Qt::CustomContextMenu);
+
+    connect(button, &QPushButton::customContextMenuRequested, [this, button, contextMenu](){
+        contextMenu->exec(QCursor::pos());
+    });
+
+    // Open In New Window functionality
+    connect(openInNewWindow, &QAction::triggered, [this, button, imagePath](){
+        // Create a new window to display the image
+        QDialog *imageDialog = new QDialog(this);
+        imageDialog->setWindowTitle("Image View");
+        QLabel *label = new QLabel(imageDialog);
+        QPixmap pixmap = QPixmap::fromImage(imageCache.image(imagePath, THUMBNAIL_SIZE));
+        label->setPixmap(pixmap.scaled(pixmap.width() * VIEWER_SCALE, pixmap.height() * VIEWER_SCALE, Qt::KeepAspectRatio));
+        QVBoxLayout *layout = new QVBoxLayout(imageDialog);
+        layout->addWidget(label);
+        QHBoxLayout *buttonLayout = new QHBoxLayout();
+        QPushButton *setGreen = new QPushButton("Mark as Good", imageDialog);
+        QPushButton *setRed = new QPushButton("Mark as Bad", imageDialog);
+        buttonLayout->addWidget(setGreen);
+        buttonLayout->addWidget(setRed);
+        layout->addLayout(buttonLayout);
+
+        if(button->palette().color(QPalette::Button) == Qt::green)
+            setGreen->setDisabled(true);
+        else if(button->palette().color(QPalette::Button) == Qt::red)
+            setRed->setDisabled(true);
+
+        connect(setGreen, &QPushButton::clicked, [this, button, imageDialog](){
+            QPalette palette;
+            palette.setColor(QPalette::Button, Qt::green);
+            button->setPalette(palette);
+            imageDialog->accept();
         });
-
-        // Delete item functionality
-        connect(deleteButton, &QAction::triggered, [this, button](){
-            layout->removeWidget(button);
-            delete button;
+        connect(setRed, &QPushButton::clicked, [this, button, imageDialog](){
+            QPalette palette;
+            palette.setColor(QPalette::Button, Qt::red);
+            button->setPalette(palette);
+            imageDialog->accept();
         });
+        imageDialog->exec();
+    });
 
-        // Increment the column and row indices
-        col++;
-        if (col == COLUMNS) {
-            col = 0;
-            row++;
-        }
+    // Delete item functionality, deferred so the menu is not destroyed while it is still executing
+    connect(deleteButton, &QAction::triggered, this, [this, button](){
+        deleteThumbnail(button);
+    }, Qt::QueuedConnection);
+
+    return button;
+}
+
+/**
+ * This function removes a thumbnail button from the grid and moves the buttons after it back one cell,
+ * so the grid stays compact and the next free cell always follows the last button. The grid is rebuilt in a
+ * single pass, since removing each following button on its own searches the layout every time.
+ *
+ * @param button The thumbnail button to delete.
+ */
+void MainWindow::deleteThumbnail(QPushButton *button)
+{
+    int index = thumbnailButtons.indexOf(button);
+    if (index < 0) {
+        return;
+    }
+
+    QWidget *gridWidget = ui->scrollArea->widget();
+    gridWidget->setUpdatesEnabled(false);
+    layout->setEnabled(false);
+
+    // Empty the grid from the back, which is cheap, and add the remaining buttons back in order
+    while (layout->count() > 0) {
+        delete layout->takeAt(layout->count() - 1);
+    }
+    QString imagePath = button->property("imagePath").toString();
+    thumbnailButtons.removeAt(index);
+    delete button;
+    imageCache.remove(imagePath);
+    for (int i = 0; i < thumbnailButtons.size(); i++) {
+        layout->addWidget(thumbnailButtons[i], i / GRID_COLUMNS, i % GRID_COLUMNS);
     }
+
+    layout->setEnabled(true);
+    layout->activate();
+    gridWidget->setUpdatesEnabled(true);
+
+    // Fill the freed space with queued images
+    loadVisibleThumbnails();
+}
+
+/**
+ * This function loads more thumbnails when the window grows to show more rows.
+ *
+ * @param event The resize event.
+ */
+void MainWindow::resizeEvent(QResizeEvent *event)
+{
+    QMainWindow::resizeEvent(event);
+    loadVisibleThumbnails();
 }
 
 /**
@@ -268,10 +414,10 @@ void MainWindow::saveGoodImages()
         QFileInfo imageFileInfo(imagePath);
         QString imageName = imageFileInfo.baseName();
 
-        // Save the button's icon to a file in the save folder
+        // Save the button's thumbnail to a file in the save folder
         QString filePath = saveFolderPath + QDir::separator() + imageName + "_good.tif";
-        QPixmap pixmap = button->icon().pixmap(button->iconSize());
-        if (!pixmap.save(filePath)) {
+        QImage thumbnail = imageCache.image(imagePath, THUMBNAIL_SIZE);
+        if (thumbnail.isNull() || !thumbnail.save(filePath)) {
             qDebug() << "Failed to save image:" << filePath;
             showLogMessage("Failed to save image: " + filePath);
             continue;
@@ -317,10 +463,22 @@ void MainWindow::saveBadImages()
         QFileInfo imageFileInfo(imagePath);
         QString imageName = imageFileInfo.baseName();
 
-        // Save the button's icon to a file in the save folder
+        // Save the button's thumbnail to a file in the save folder
+        QString filePath = saveFolderPath + QDir::separator() + imageName + "_bad.tif";
+        QImage thumbnail = imageCache.image(imagePath, THUMBNAIL_SIZE);
+        if (thumbnail.isNull() || !thumbnail.save(filePath)) {
+            qDebug() << "Failed to save image:" << filePath;
+            showLogMessage("Failed to save image: " + filePath);
+            continue;
+        }
+    }
+
+    // Images without a button yet have not been marked good, so they are saved from the image cache
+    for (const QString &imagePath : pendingImages) {
+        QString imageName = QFileInfo(imagePath).baseName();
         QString filePath = saveFolderPath + QDir::separator() + imageName + "_bad.tif";
-        QPixmap pixmap = button->icon().pixmap(button->iconSize());
-        if (!pixmap.save(filePath)) {
+        QImage thumbnail = imageCache.image(imagePath, THUMBNAIL_SIZE);
+        if (thumbnail.isNull() || !thumbnail.save(filePath)) {
             qDebug() << "Failed to save image:" << filePath;
             showLogMessage("Failed to save image: " + filePath);
             continue;
@@ -359,6 +517,9 @@ void MainWindow::viewGoodImages(int state)
         // Set the button's visibility based on the state of the green checkbox
         button->setVisible(state == Qt::Checked);
     }
+
+    // Hiding buttons frees rows, and showing bad images again resumes loading the queue
+    loadVisibleThumbnails();
 }
 
 
@@ -392,6 +553,9 @@ void MainWindow::viewBadImages(int state)
         // Set the button's visibility based on the state of the red checkbox
         button->setVisible(state == Qt::Checked);
     }
+
+    // Hiding buttons frees rows, and showing bad images again resumes loading the queue
+    loadVisibleThumbnails();
 }
 
 /**
@@ -441,10 +605,10 @@ void MainWindow::uploadRawFolder()
 }
 
 /**
- * This function is a helper function for uploadRawFolder. It takes in a subfolder, sorts images into
- * appropriate lists, and then calls the stitchImage helper function on the images. It assumes that the
- * subfolder passed to it contains 4 channels with naming conventions CH1, CH2, CH3, and CH4, and that
- * there exists an overlay of all channels with naming convention Overlay.
+ * This function is a helper function for uploadRawFolder. It takes in a subfolder, resolves the tile layout
+ * of the subfolder once, sorts images into appropriate lists, and then calls the stitchImages helper function
+ * on the images. It assumes that the subfolder passed to it contains 4 channels with naming conventions CH1,
+ * CH2, CH3, and CH4, and that there exists an overlay of all channels with naming convention Overlay.
  *
  * @author Kai Jun Zhuang
  * @param folderPath The path to the subfolder passed in uploadRawFolder.
@@ -460,6 +624,14 @@ void MainWindow::stitchFolder(QString folderPath, QString savePath, QString file
     folder.setNameFilters(filters);
     QStringList tifFiles = folder.entryList(QDir::Files);
 
+    // Resolve where each tile goes once for all channels
+    TileLayout tileLayout = TileLayout::fromFolder(folderPath, tifFiles, ui->gridColumnsSpinBox->value());
+    if (tileLayout.isShapeGuessed()) {
+        showLogMessage("The tiles of " + fileName + " do not form a square grid and have no stage positions, so "
+                       + QString::number(tileLayout.columns()) + " columns were assumed. "
+                       + "Set Grid Columns if the mosaic is laid out wrong.");
+    }
+
     // Initialize lists
     QStringList ch1;
     QStringList ch2;
@@ -483,185 +655,76 @@ void MainWindow::stitchFolder(QString folderPath, QString savePath, QString file
     }
 
     // Stitch images in each of the lists
-    stitchImages(ch1, savePath, fileName + "_CH1");
-    stitchImages(ch2, savePath, fileName + "_CH2");
-    stitchImages(ch3, savePath, fileName + "_CH3");
-    stitchImages(ch4, savePath, fileName + "_CH4");
-    stitchImages(overlay, savePath, fileName + "_Overlay");
+    stitchImages(tileLayout, ch1, savePath, fileName + "_CH1");
+    stitchImages(tileLayout, ch2, savePath, fileName + "_CH2");
+    stitchImages(tileLayout, ch3, savePath, fileName + "_CH3");
+    stitchImages(tileLayout, ch4, savePath, fileName + "_CH4");
+    stitchImages(tileLayout, overlay, savePath, fileName + "_Overlay");
     showLogMessage("Stitched images for " + fileName + " saved to " + savePath);
 }
 
 /**
- * This function is a helper function for the stitchFolder function. It takes a list of images,
- * ensures that there are 9, 16, 25 images, stitches the images together, and then saves the images to
- * the savePath.
+ * This function is a helper function for the stitchFolder function. It takes a list of images and the
+ * layout of their folder, draws every image that lands in the layout onto a single mosaic, and then saves
+ * the mosaic to the savePath. Tiles that are missing from the folder are left blank.
  *
  * @author Kai Jun Zhuang
+ * @param tileLayout The tile layout resolved for the folder the images are in.
  * @param fileNames A list of the file paths to each image.
  * @param savePath The path to save stitched images to.
  * @param fileName The name for the saved image.
  */
-void MainWindow::stitchImages(QStringList fileNames, QString savePath, QString fileName)
+void MainWindow::stitchImages(const TileLayout &tileLayout, QStringList fileNames, QString savePath, QString fileName)
 {
-    // Decide which stitch to perform
-    if (fileNames.size() == 9) {
-        stitch3x3(fileNames, savePath, fileName);
-    } else if (fileNames.size() == 16) {
-        stitch4x4(fileNames, savePath, fileName);
-    } else if (fileNames.size() == 25) {
-        stitch5x5(fileNames, savePath, fileName);
-    } else {
-        // The number of images is not related to a possible stitch.
-        qDebug() << "Wrong number of images for " + fileName + " please ensure there are exactly 9, 16, or 25 images to complete a stitch.";
-        showLogMessage("Wrong number of images for " + fileName + ". Please ensure there are exactly 9, 16, or 25 images to complete a stitch.");
+    // Only tiles that land in the layout are decoded
+    QVector<TilePlacement> placements = tileLayout.placements(fileNames);
+    if (placements.isEmpty()) {
+        qDebug() << "No tiles found for " + fileName + " please ensure the images follow the XY##_#####_CH# naming convention.";
+        showLogMessage("No tiles found for " + fileName + ". Please ensure the images follow the XY##_#####_CH# naming convention.");
         return;
     }
-}
-
-void MainWindow::stitch3x3(QStringList fileNames, QString savePath, QString fileName) {
-    // Check if there are 9 images in the fileNames list, if not return an error to console
-    if (fileNames.size() == 9) {
-        // Load the images
-        QImage image1(fileNames[0]);
-        QImage image2(fileNames[1]);
-        QImage image3(fileNames[2]);
-        // Account for how files are ordered
-        QImage image4(fileNames[5]);
-        QImage image5(fileNames[4]);
-        // Account for how files are ordered
-        QImage image6(fileNames[3]);
-        QImage image7(fileNames[6]);
-        QImage image8(fileNames[7]);
-        QImage image9(fileNames[8]);
-
-        // Create a QPixmap to paint on
-        QPixmap pixmap(image1.width() * 3 - 578, image1.height() * 3 - 432);
-
-        // Create a QPainter to draw on the pixmap
-        QPainter painter(&pixmap);
-
-        // Draw the images onto the pixmap
-        painter.drawImage(0, 0, image1);
-        painter.drawImage(image1.width() - 289, 0, image2);
-        painter.drawImage(image1.width() * 2 - 578, 0, image3);
-        painter.drawImage(0, image1.height() - 216, image4);
-        painter.drawImage(image1.width() - 289, image1.height() - 216, image5);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() - 216, image6);
-        painter.drawImage(0, image1.height() * 2 - 432, image7);
-        painter.drawImage(image1.width() - 289, image1.height() * 2 - 432, image8);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() * 2 - 432, image9);
-
-        // Convert the pixmap to an image
-        QImage image = pixmap.toImage();
-
-        // Show a file dialog to select the output file
-        QString filePath = savePath + "/" + fileName + ".png";
-
-        // Save the image to the selected file
-        image.save(filePath);
-    } else {
-        // There were fewer/more than 9 images for the respective channel so log an error message
-        qDebug() << "Missing images for " + fileName + " please ensure there are exactly 9 images to complete the stitch.";
-        showLogMessage("Missing images for " + fileName + ". Please ensure there are exactly 9 images to complete the stitch.");
-        return;
+    if (placements.size() < tileLayout.rows() * tileLayout.columns()) {
+        qDebug() << "Missing" << tileLayout.rows() * tileLayout.columns() - placements.size() << "tiles for" << fileName;
     }
-}
 
-void MainWindow::stitch4x4(QStringList fileNames, QString savePath, QString fileName) {
-    // Check if there are 16 images in the fileNames list, if not return an error to console
-    if (fileNames.size() == 16) {
-        // Load the images
-        QImage image1(fileNames[0]);
-        QImage image2(fileNames[1]);
-        QImage image3(fileNames[2]);
-        // Account for how files are ordered
-        QImage image4(fileNames[5]);
-        QImage image5(fileNames[4]);
-        // Account for how files are ordered
-        QImage image6(fileNames[3]);
-        QImage image7(fileNames[6]);
-        QImage image8(fileNames[7]);
-        QImage image9(fileNames[8]);
-
-        // Create a QPixmap to paint on
-        QPixmap pixmap(image1.width() * 3 - 578, image1.height() * 3 - 432);
-
-        // Create a QPainter to draw on the pixmap
-        QPainter painter(&pixmap);
-
-        // Draw the images onto the pixmap
-        painter.drawImage(0, 0, image1);
-        painter.drawImage(image1.width() - 289, 0, image2);
-        painter.drawImage(image1.width() * 2 - 578, 0, image3);
-        painter.drawImage(0, image1.height() - 216, image4);
-        painter.drawImage(image1.width() - 289, image1.height() - 216, image5);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() - 216, image6);
-        painter.drawImage(0, image1.height() * 2 - 432, image7);
-        painter.drawImage(image1.width() - 289, image1.height() * 2 - 432, image8);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() * 2 - 432, image9);
-
-        // Convert the pixmap to an image
-        QImage image = pixmap.toImage();
-
-        // Show a file dialog to select the output file
-        QString filePath = savePath + "/" + fileName + ".png";
-
-        // Save the image to the selected file
-        image.save(filePath);
-    } else {
-        // There were fewer/more than 16 images for the respective channel so log an error message
-        qDebug() << "Missing images for " + fileName + " please ensure there are exactly 16 images to complete the stitch.";
-        showLogMessage("Missing images for " + fileName + ". Please ensure there are exactly 16 images to complete the stitch.");
+    // Read the tile size from the header of the first tile without decoding it
+    QSize tileSize = QImageReader(placements.first().path).size();
+    if (!tileSize.isValid()) {
+        tileSize = QImage(placements.first().path).size();
+    }
+    if (tileSize.isEmpty()) {
+        qDebug() << "Failed to read tile size for " + fileName;
+        showLogMessage("Failed to read tile size for " + fileName + ".");
         return;
     }
-}
 
-void MainWindow::stitch5x5(QStringList fileNames, QString savePath, QString fileName) {
-    // Check if there are 25 images in the fileNames list, if not return an error to console
-    if (fileNames.size() == 25) {
-        // Load the images
-        QImage image1(fileNames[0]);
-        QImage image2(fileNames[1]);
-        QImage image3(fileNames[2]);
-        // Account for how files are ordered
-        QImage image4(fileNames[5]);
-        QImage image5(fileNames[4]);
-        // Account for how files are ordered
-        QImage image6(fileNames[3]);
-        QImage image7(fileNames[6]);
-        QImage image8(fileNames[7]);
-        QImage image9(fileNames[8]);
-
-        // Create a QPixmap to paint on
-        QPixmap pixmap(image1.width() * 3 - 578, image1.height() * 3 - 432);
-
-        // Create a QPainter to draw on the pixmap
-        QPainter painter(&pixmap);
-
-        // Draw the images onto the pixmap
-        painter.drawImage(0, 0, image1);
-        painter.drawImage(image1.width() - 289, 0, image2);
-        painter.drawImage(image1.width() * 2 - 578, 0, image3);
-        painter.drawImage(0, image1.height() - 216, image4);
-        painter.drawImage(image1.width() - 289, image1.height() - 216, image5);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() - 216, image6);
-        painter.drawImage(0, image1.height() * 2 - 432, image7);
-        painter.drawImage(image1.width() - 289, image1.height() * 2 - 432, image8);
-        painter.drawImage(image1.width() * 2 - 578, image1.height() * 2 - 432, image9);
-
-        // Convert the pixmap to an image
-        QImage image = pixmap.toImage();
-
-        // Show a file dialog to select the output file
-        QString filePath = savePath + "/" + fileName + ".png";
-
-        // Save the image to the selected file
-        image.save(filePath);
-    } else {
-        // There were fewer/more than 25 images for the respective channel so log an error message
-        qDebug() << "Missing images for " + fileName + " please ensure there are exactly 25 images to complete the stitch.";
-        showLogMessage("Missing images for " + fileName + ". Please ensure there are exactly 25 images to complete the stitch.");
-        return;
+    // Neighbouring tiles overlap, so each step is smaller than the tile itself
+    int stepX = tileSize.width() - TILE_OVERLAP_X;
+    int stepY = tileSize.height() - TILE_OVERLAP_Y;
+
+    // Create an image to paint on
+    QImage image(stepX * (tileLayout.columns() - 1) + tileSize.width(),
+                 stepY * (tileLayout.rows() - 1) + tileSize.height(),
+                 QImage::Format_RGB32);
+    image.fill(Qt::black);
+
+    // Draw the tiles onto the image in row-major order so overlaps match the original captures. Tiles are
+    // only read once, so they are decoded directly instead of pushing thumbnails out of the image cache.
+    QPainter painter(&image);
+    for (const TilePlacement &placement : placements) {
+        QImage tile(placement.path);
+        if (tile.isNull()) {
+            continue;
+        }
+        painter.drawImage(placement.column * stepX, placement.row * stepY, tile);
+    }
+    painter.end();
+
+    // Save the image to the output file in the selected format
+    ImageEncoder::OutputFormat format = ImageEncoder::OutputFormat(ui->outputFormatComboBox->currentIndex());
+    QString filePath = savePath + "/" + fileName + "." + ImageEncoder::suffix(format);
+    if (!ImageEncoder::save(image, filePath, format)) {
+        qDebug() << "Failed to save image:" << filePath;
+        showLogMessage("Failed to save image: " + filePath);
     }
 }
-
@@ -13,6 +13,10 @@
 #include <QtGui>
 #include <QLabel>
 
+#include "imagecache.h"
+#include "imageencoder.h"
+#include "tilelayout.h"
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
@@ -40,19 +44,27 @@ private:
     QStringList ch3;
     QStringList ch4;
     QStringList overlay;
+    ImageCache imageCache;
+    QList<QPushButton*> thumbnailButtons;
+    QStringList pendingImages;
+
+    QPushButton *createThumbnailButton(const QString &imagePath);
+    void deleteThumbnail(QPushButton *button);
+    void updateThumbnailIcons();
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
 
 private slots:
     void showLogMessage(const QString& message);
     void uploadFolder();
+    void loadVisibleThumbnails();
     void saveGoodImages();
     void saveBadImages();
     void viewGoodImages(int);
     void viewBadImages(int);
     void uploadRawFolder();
     void stitchFolder(QString folderPath, QString savePath, QString fileName);
-    void stitchImages(QStringList fileNames, QString savePath, QString fileName);
-    void stitch3x3(QStringList fileNames, QString savePath, QString fileName);
-    void stitch4x4(QStringList fileNames, QString savePath, QString fileName);
-    void stitch5x5(QStringList fileNames, QString savePath, QString fileName);
+    void stitchImages(const TileLayout &tileLayout, QStringList fileNames, QString savePath, QString fileName);
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,313 @@
+#include "tilelayout.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QRegularExpression>
+#include <QtGui>
+#include <QtMath>
+#include <algorithm>
+
+// Baseline TIFF tags describing the size and stage position of the tile
+static const quint16 TIFF_TAG_IMAGE_WIDTH = 256;
+static const quint16 TIFF_TAG_IMAGE_LENGTH = 257;
+static const quint16 TIFF_TAG_X_RESOLUTION = 282;
+static const quint16 TIFF_TAG_Y_RESOLUTION = 283;
+static const quint16 TIFF_TAG_X_POSITION = 286;
+static const quint16 TIFF_TAG_Y_POSITION = 287;
+static const quint16 TIFF_TYPE_SHORT = 3;
+static const quint16 TIFF_TYPE_LONG = 4;
+static const quint16 TIFF_TYPE_RATIONAL = 5;
+
+TileLayout::TileLayout()
+    : rowCount(0)
+    , columnCount(0)
+    , shapeGuessed(false)
+{
+}
+
+/**
+ * This function builds the placement table for an XY folder. Tile indices are parsed from the file names of
+ * every channel so a tile missing from one channel does not shift the others. Tiles are placed by stage
+ * position when every tile has one, and by serpentine acquisition order on a grid of the given number of
+ * columns otherwise.
+ *
+ * @param folderPath The path to the XY folder.
+ * @param tifFiles The names of the .tif files in the folder.
+ * @param columns The number of columns of the grid for tiles without stage positions, 0 for a square grid.
+ * @return The resolved layout, empty if the folder contains no tiles.
+ */
+TileLayout TileLayout::fromFolder(const QString &folderPath, const QStringList &tifFiles, int columns)
+{
+    TileLayout layout;
+
+    // Find the file describing each tile, so every tile is only probed once
+    QMap<int, QString> tiles;
+    QHash<QString, int> unindexedPerChannel;
+    static const QRegularExpression channelPattern("(CH\\d+|Overlay)", QRegularExpression::CaseInsensitiveOption);
+    for (const QString &file : tifFiles) {
+        int index = tileIndex(file);
+        if (index > 0) {
+            if (!tiles.contains(index)) {
+                tiles.insert(index, folderPath + "/" + file);
+            }
+        } else {
+            unindexedPerChannel[channelPattern.match(file).captured(1)]++;
+        }
+    }
+
+    // Without indices in the names fall back to the list order used by placements
+    if (tiles.isEmpty()) {
+        int count = 0;
+        for (int channelCount : unindexedPerChannel) {
+            count = qMax(count, channelCount);
+        }
+        for (int index = 1; index <= count; index++) {
+            tiles.insert(index, QString());
+        }
+    }
+    if (tiles.isEmpty()) {
+        return layout;
+    }
+
+    // Place tiles by stage position if every tile has one
+    QVector<int> indices;
+    QVector<double> xs;
+    QVector<double> ys;
+    QSizeF extent;
+    for (auto it = tiles.constBegin(); it != tiles.constEnd(); ++it) {
+        QPointF position;
+        if (it.value().isEmpty() || !readStagePosition(it.value(), position, extent)) {
+            break;
+        }
+        indices.append(it.key());
+        xs.append(position.x());
+        ys.append(position.y());
+    }
+    if (indices.size() == tiles.size()) {
+        QVector<int> columns = clusterCoordinates(xs, extent.width());
+        QVector<int> rows = clusterCoordinates(ys, extent.height());
+        for (int i = 0; i < indices.size(); i++) {
+            layout.cells.insert(indices[i], QPoint(columns[i], rows[i]));
+            layout.columnCount = qMax(layout.columnCount, columns[i] + 1);
+            layout.rowCount = qMax(layout.rowCount, rows[i] + 1);
+        }
+        return layout;
+    }
+
+    // Otherwise use the given column count, or assume a square grid sized by the highest tile index, leaving
+    // missing tiles empty
+    int tileCount = tiles.lastKey();
+    if (columns > 0) {
+        layout.columnCount = columns;
+    } else {
+        layout.columnCount = qCeil(qSqrt(double(tileCount)));
+        layout.shapeGuessed = layout.columnCount * layout.columnCount != tileCount;
+        if (layout.shapeGuessed) {
+            qDebug() << "Tiles in" << folderPath << "do not form a square grid, assuming" << layout.columnCount << "columns";
+        }
+    }
+    layout.rowCount = (tileCount + layout.columnCount - 1) / layout.columnCount;
+    for (int index : tiles.keys()) {
+        int row = (index - 1) / layout.columnCount;
+        int column = (index - 1) % layout.columnCount;
+        if (row % 2 == 1) {
+            column = layout.columnCount - 1 - column;
+        }
+        layout.cells.insert(index, QPoint(column, row));
+    }
+    return layout;
+}
+
+/**
+ * This function parses the 1-based tile index from a Keyence style file name, e.g. 4 for
+ * "Image_XY01_00004_CH1.tif".
+ *
+ * @param fileName The name of the tile image.
+ * @return The tile index, or -1 if the name does not contain one.
+ */
+int TileLayout::tileIndex(const QString &fileName)
+{
+    static const QRegularExpression indexPattern("XY\\d+_(\\d+)", QRegularExpression::CaseInsensitiveOption);
+    QRegularExpressionMatch match = indexPattern.match(fileName);
+    if (!match.hasMatch()) {
+        return -1;
+    }
+    return match.captured(1).toInt();
+}
+
+/**
+ * This function maps the images of one channel onto the layout. Images whose tile does not land in the
+ * layout are left out, so the stitcher never decodes them. Names without a tile index are placed by their
+ * position in the list. The placements are returned in row-major order.
+ *
+ * @param filePaths The sorted paths to the images of a channel.
+ * @return The placement of each image in the layout.
+ */
+QVector<TilePlacement> TileLayout::placements(const QStringList &filePaths) const
+{
+    QVector<TilePlacement> result;
+    for (int i = 0; i < filePaths.size(); i++) {
+        int index = tileIndex(QFileInfo(filePaths[i]).fileName());
+        if (index <= 0) {
+            index = i + 1;
+        }
+        auto cell = cells.constFind(index);
+        if (cell == cells.constEnd()) {
+            continue;
+        }
+        result.append({ filePaths[i], cell->y(), cell->x() });
+    }
+
+    std::sort(result.begin(), result.end(), [](const TilePlacement &a, const TilePlacement &b) {
+        return a.row != b.row ? a.row < b.row : a.column < b.column;
+    });
+    return result;
+}
+
+int TileLayout::rows() const
+{
+    return rowCount;
+}
+
+int TileLayout::columns() const
+{
+    return columnCount;
+}
+
+/**
+ * This function tells whether the grid shape had to be guessed, i.e. the tiles have no stage positions, no
+ * column count was given and the tile count is not a perfect square, so the square grid is likely wrong.
+ *
+ * @return True if the column count was guessed.
+ */
+bool TileLayout::isShapeGuessed() const
+{
+    return shapeGuessed;
+}
+
+/**
+ * This function reads the stage position and the physical size of a tile from the first IFD of a TIFF file
+ * without decoding any pixel data. Both are in the file's resolution unit.
+ *
+ * @param filePath The path to the TIFF file.
+ * @param position [out] The stage position of the tile.
+ * @param extent [out] The width and height of the tile.
+ * @return True if the size, resolution and position tags were all present.
+ */
+bool TileLayout::readStagePosition(const QString &filePath, QPointF &position, QSizeF &extent)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    QByteArray byteOrder = file.read(2);
+    bool littleEndian = byteOrder == "II";
+    if (littleEndian) {
+        stream.setByteOrder(QDataStream::LittleEndian);
+    } else if (byteOrder == "MM") {
+        stream.setByteOrder(QDataStream::BigEndian);
+    } else {
+        return false;
+    }
+
+    quint16 magic;
+    quint32 ifdOffset;
+    stream >> magic >> ifdOffset;
+    if (magic != 42 || !file.seek(ifdOffset)) {
+        return false;
+    }
+
+    // Collect the image size and the offsets of the rational values
+    quint16 entryCount;
+    stream >> entryCount;
+    quint32 width = 0;
+    quint32 height = 0;
+    QHash<quint16, quint32> rationalOffsets;
+    for (int i = 0; i < entryCount && stream.status() == QDataStream::Ok; i++) {
+        quint16 tag;
+        quint16 type;
+        quint32 count;
+        quint32 value;
+        stream >> tag >> type >> count >> value;
+        if (tag == TIFF_TAG_IMAGE_WIDTH || tag == TIFF_TAG_IMAGE_LENGTH) {
+            // A SHORT value sits in the first two bytes of the value field
+            if (type == TIFF_TYPE_SHORT) {
+                value = littleEndian ? value & 0xffff : value >> 16;
+            } else if (type != TIFF_TYPE_LONG) {
+                continue;
+            }
+            (tag == TIFF_TAG_IMAGE_WIDTH ? width : height) = value;
+        } else if (type == TIFF_TYPE_RATIONAL
+                   && (tag == TIFF_TAG_X_RESOLUTION || tag == TIFF_TAG_Y_RESOLUTION
+                       || tag == TIFF_TAG_X_POSITION || tag == TIFF_TAG_Y_POSITION)) {
+            rationalOffsets.insert(tag, value);
+        }
+    }
+    if (width == 0 || height == 0 || rationalOffsets.size() != 4) {
+        return false;
+    }
+
+    QHash<quint16, double> rationals;
+    for (auto it = rationalOffsets.constBegin(); it != rationalOffsets.constEnd(); ++it) {
+        quint32 numerator;
+        quint32 denominator;
+        if (!file.seek(it.value())) {
+            return false;
+        }
+        stream >> numerator >> denominator;
+        if (denominator == 0) {
+            return false;
+        }
+        rationals.insert(it.key(), double(numerator) / denominator);
+    }
+    if (stream.status() != QDataStream::Ok
+        || rationals[TIFF_TAG_X_RESOLUTION] <= 0 || rationals[TIFF_TAG_Y_RESOLUTION] <= 0) {
+        return false;
+    }
+
+    position = QPointF(rationals[TIFF_TAG_X_POSITION], rationals[TIFF_TAG_Y_POSITION]);
+    extent = QSizeF(width / rationals[TIFF_TAG_X_RESOLUTION], height / rationals[TIFF_TAG_Y_RESOLUTION]);
+    return true;
+}
+
+/**
+ * This function assigns stage coordinates along one axis to grid lines. Neighbouring tiles overlap by less
+ * than half a tile, so a step between grid lines is always larger than half the tile extent and any smaller
+ * gap is stage jitter between tiles on the same line. The smallest real step is taken as the grid pitch and
+ * every coordinate is rounded to a whole number of pitches, so a missing line is left empty instead of
+ * collapsing. An axis without any real step is a single line.
+ *
+ * @param values The coordinate of each tile along the axis.
+ * @param extent The size of a tile along the axis, in the same unit as the coordinates.
+ * @return The 0-based grid line of each tile.
+ */
+QVector<int> TileLayout::clusterCoordinates(const QVector<double> &values, double extent)
+{
+    QVector<int> lines(values.size(), 0);
+    if (values.isEmpty()) {
+        return lines;
+    }
+
+    QVector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    double step = 0;
+    for (int i = 1; i < sorted.size(); i++) {
+        double gap = sorted[i] - sorted[i - 1];
+        if (gap > extent / 2 && (step == 0 || gap < step)) {
+            step = gap;
+        }
+    }
+    if (step == 0) {
+        return lines;
+    }
+
+    for (int i = 0; i < values.size(); i++) {
+        lines[i] = qRound((values[i] - sorted.first()) / step);
+    }
+    return lines;
+}
@@ -0,0 +1,55 @@
+#ifndef TILELAYOUT_H
+#define TILELAYOUT_H
+
+#include <QHash>
+#include <QPoint>
+#include <QPointF>
+#include <QSizeF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * The cell a single tile image occupies in a stitched mosaic.
+ */
+struct TilePlacement
+{
+    QString path;
+    int row;
+    int column;
+};
+
+/**
+ * A placement table mapping tile indices to grid cells for one XY folder.
+ *
+ * The table is resolved once per folder from the Keyence style file names ("<name>_XY01_00004_CH1.tif"), where
+ * the number after the XY group is the 1-based index of the tile in acquisition order. If every tile carries
+ * the TIFF XPosition/YPosition and resolution tags, the stage coordinates are used to place tiles directly,
+ * which supports any grid shape. Otherwise the tiles are assumed to be captured in serpentine order, i.e. every
+ * other row runs right to left, on a grid with the column count chosen by the user, or on a square grid if no
+ * column count was given.
+ */
+class TileLayout
+{
+public:
+    TileLayout();
+
+    static TileLayout fromFolder(const QString &folderPath, const QStringList &tifFiles, int columns);
+    static int tileIndex(const QString &fileName);
+
+    QVector<TilePlacement> placements(const QStringList &filePaths) const;
+    int rows() const;
+    int columns() const;
+    bool isShapeGuessed() const;
+
+private:
+    static bool readStagePosition(const QString &filePath, QPointF &position, QSizeF &extent);
+    static QVector<int> clusterCoordinates(const QVector<double> &values, double extent);
+
+    QHash<int, QPoint> cells;
+    int rowCount;
+    int columnCount;
+    bool shapeGuessed;
+};
+
+#endif // TILELAYOUT_H